@@ -0,0 +1,131 @@
+#ifndef GL_TUT_FEEDBACK_RENDER_STEP_HPP
+#define GL_TUT_FEEDBACK_RENDER_STEP_HPP
+
+
+#include "gl_tut.hpp"
+
+#include <string>
+#include <vector>
+
+
+#ifndef GL_TUT_SOURCE_DIR
+    #define GL_TUT_SOURCE_DIR ".."
+#endif
+
+
+namespace gl_tut
+{
+    class feedback_render_step : public render_step
+    {
+    public:
+        GL_shader_program* shader_program;
+        GLuint data_vbo;
+        GLuint result_vbo;
+        GLuint query;
+        std::vector< float > data;
+        std::vector< float > results;   // Read back by the last run()
+        
+        feedback_render_step() : data( { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f } )
+        {
+            auto shader = GL_shader::from_file(
+                GL_VERTEX_SHADER,
+                std::string( GL_TUT_SOURCE_DIR ) + "/src/feedback.vert"
+            );
+            
+            shader_program = new GL_shader_program( {
+                shader.id
+            } );
+            shader_program -> use();
+            
+            glGenBuffers( 1, &data_vbo );
+            glBindBuffer( GL_ARRAY_BUFFER, data_vbo );
+            glBufferData(
+               GL_ARRAY_BUFFER,
+               data.size() * sizeof( float ),
+               data.data(),
+               GL_STATIC_DRAW
+            );
+            
+            GLint data_attr = shader_program -> attribute( "value_in" );
+            glEnableVertexAttribArray( data_attr );
+            glVertexAttribPointer(
+                data_attr,           // Data source
+                1,                   // Components per element
+                GL_FLOAT,            // Component type
+                GL_FALSE,            // Components should be normalized
+                1 * sizeof( float ), // Component stride in bytes (0 = packed)
+                ( void* )( 0 * sizeof( float ) )
+                                     // Component offset within stride
+            );
+            
+            glGenBuffers( 1, &result_vbo );
+            glBindBuffer( GL_ARRAY_BUFFER, result_vbo );
+            glBufferData(
+               GL_ARRAY_BUFFER,
+               data.size() * sizeof( float ),
+               nullptr,
+               GL_STATIC_READ
+            );
+            
+            glGenQueries( 1, &query );
+        }
+        
+        ~feedback_render_step()
+        {
+            glDeleteQueries( 1, &query );
+            glDeleteBuffers( 1, &result_vbo );
+            glDeleteBuffers( 1, &data_vbo );
+            delete shader_program;
+        }
+        
+        void run( GL_framebuffer& previous_framebuffer )
+        {
+            shader_program -> use();
+            
+            glEnable( GL_RASTERIZER_DISCARD );
+            
+            glBindBufferBase(
+                GL_TRANSFORM_FEEDBACK_BUFFER,
+                0,          // Index of output variable
+                result_vbo  // Buffer object to bind
+            );
+            
+            glBeginQuery(
+                GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
+                    // GL_PRIMITIVES_GENERATED, GL_TIME_ELAPSED
+                query
+            );
+            // Must match output of geom shader when using one
+            glBeginTransformFeedback( GL_POINTS );
+            glDrawArrays( GL_POINTS, 0, static_cast< GLsizei >( data.size() ) );
+            glEndTransformFeedback();
+            glEndQuery( GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN );
+            
+            glFlush();
+            
+            GLuint count_primitives;
+            glGetQueryObjectuiv(
+                query,
+                GL_QUERY_RESULT,
+                &count_primitives
+            );
+            
+            results.resize( count_primitives );
+            glGetBufferSubData(
+                GL_TRANSFORM_FEEDBACK_BUFFER,
+                0,
+                (
+                    count_primitives    // Number primitives generated
+                    * 1                 // Number of floats per primitive
+                    * sizeof( float )
+                ),
+                results.data()
+            );
+            
+            glDisable( GL_RASTERIZER_DISCARD );
+        }
+    };
+}
+
+
+#endif
@@ -0,0 +1,629 @@
+#include "gl_tut.hpp"
+#include "feedback_render_step.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Regression harness for the render steps, meant to be run headless through
+// ctest (see CMakeLists.txt for the llvmpipe/offscreen environment).  Set
+// GL_TUT_UPDATE_GOLDEN or GL_TUT_UPDATE_BASELINES to rewrite the golden
+// images or timing baselines from the current run instead of checking them.
+// Exits with skip_return_code when the frame and timing checks could not be
+// made, so ctest reports them as not run rather than passed.
+
+
+namespace
+{
+    const int framebuffer_width  = 64;
+    const int framebuffer_height = 64;
+    
+    // Maximum absolute difference allowed between the feedback shader's
+    // results and the CPU reference
+    const float feedback_tolerance = 1.0e-5f;
+    
+    // Maximum per-channel difference (out of 255) allowed against a golden
+    // image before a pixel counts as mismatched
+    const int golden_channel_tolerance = 2;
+    
+    // Iterations discarded before timing (shader compilation, first buffer
+    // allocations, etc.), then the number of samples taken; each sample is
+    // the mean of a batch of back-to-back runs so the harness's own
+    // glFinish() is amortized instead of dominating a single tiny run
+    const int timing_warmup_runs     = 50;
+    const int timing_samples         = 40;
+    const int timing_runs_per_sample = 25;
+    
+    // Used for steps without an explicit slowdown threshold in the baseline
+    // file, as a fraction of the baseline's upper confidence bound
+    const double default_max_slowdown = 0.1;
+    
+    // Baselines and goldens are only meaningful on the renderer that
+    // recorded them
+    const std::string expected_renderer = "llvmpipe";
+    
+    // Must match SKIP_RETURN_CODE in CMakeLists.txt
+    const int skip_return_code = 77;
+    
+    const std::string golden_dir    = GL_TUT_SOURCE_DIR "/test/golden";
+    const std::string baseline_file = GL_TUT_SOURCE_DIR "/test/baselines.txt";
+    
+    struct test_case
+    {
+        std::string          name;
+        gl_tut::render_step* step;
+    };
+    
+    enum class check_result
+    {
+        passed,
+        failed,
+        skipped
+    };
+    
+    // Median and ~95% confidence interval of a step's per-run time
+    struct timing
+    {
+        double median_ms;
+        double lower_ms;
+        double upper_ms;
+    };
+    
+    struct baseline
+    {
+        timing recorded;
+        double max_slowdown;
+    };
+    
+    bool env_set( const char* name )
+    {
+        const char* value = std::getenv( name );
+        return value != nullptr && std::string( value ) != "0";
+    }
+    
+    void run_step(
+        gl_tut::render_step& step,
+        gl_tut::GL_framebuffer& framebuffer
+    )
+    {
+        glBindFramebuffer( GL_FRAMEBUFFER, framebuffer.id );
+        glViewport( 0, 0, framebuffer.width, framebuffer.height );
+        glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+        glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
+        step.run( framebuffer );
+        glFinish();
+    }
+    
+    bool check_feedback(
+        gl_tut::feedback_render_step& step,
+        gl_tut::GL_framebuffer& framebuffer
+    )
+    {
+        run_step( step, framebuffer );
+        
+        if( step.results.size() != step.data.size() )
+        {
+            std::cerr
+                << "feedback: expected "
+                << step.data.size()
+                << " results, got "
+                << step.results.size()
+                << std::endl
+            ;
+            return false;
+        }
+        
+        bool passed = true;
+        for( std::size_t i = 0; i < step.results.size(); ++i )
+        {
+            // CPU reference of feedback.vert
+            float expected = std::sqrt( step.data[ i ] );
+            if( std::abs( step.results[ i ] - expected ) > feedback_tolerance )
+            {
+                std::cerr
+                    << "feedback: result "
+                    << i
+                    << " was "
+                    << step.results[ i ]
+                    << ", expected "
+                    << expected
+                    << std::endl
+                ;
+                passed = false;
+            }
+        }
+        return passed;
+    }
+    
+    // Returns tightly-packed RGB24 rows, top row first to match image files
+    std::vector< unsigned char > read_pixels( gl_tut::GL_framebuffer& framebuffer )
+    {
+        std::size_t row_size = framebuffer.width * 3;
+        std::vector< unsigned char > pixels( row_size * framebuffer.height );
+        
+        glBindFramebuffer( GL_FRAMEBUFFER, framebuffer.id );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glReadPixels(
+            0, 0,
+            framebuffer.width, framebuffer.height,
+            GL_RGB,
+            GL_UNSIGNED_BYTE,
+            pixels.data()
+        );
+        
+        // OpenGL's origin is the bottom-left corner
+        for( GLsizei y = 0; y < framebuffer.height / 2; ++y )
+            std::swap_ranges(
+                pixels.begin() + y * row_size,
+                pixels.begin() + ( y + 1 ) * row_size,
+                pixels.begin() + ( framebuffer.height - 1 - y ) * row_size
+            );
+        
+        return pixels;
+    }
+    
+    void save_png(
+        const std::string& filename,
+        std::vector< unsigned char >& pixels,
+        int width,
+        int height
+    )
+    {
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+            pixels.data(),
+            width, height,
+            24,             // Bits per pixel
+            width * 3,      // Pitch
+            SDL_PIXELFORMAT_RGB24
+        );
+        if( surface == nullptr )
+            throw std::runtime_error(
+                "failed to create surface for \""
+                + filename
+                + "\": "
+                + std::string( SDL_GetError() )
+            );
+        int status = IMG_SavePNG( surface, filename.c_str() );
+        SDL_FreeSurface( surface );
+        if( status != 0 )
+            throw std::runtime_error(
+                "failed to save \""
+                + filename
+                + "\": "
+                + std::string( IMG_GetError() )
+            );
+    }
+    
+    bool check_golden(
+        const test_case& test,
+        gl_tut::GL_framebuffer& framebuffer,
+        bool update
+    )
+    {
+        run_step( *test.step, framebuffer );
+        auto pixels = read_pixels( framebuffer );
+        
+        std::string golden_filename = golden_dir + "/" + test.name + ".png";
+        if( update )
+        {
+            save_png(
+                golden_filename,
+                pixels,
+                framebuffer.width,
+                framebuffer.height
+            );
+            std::cout << test.name << ": wrote " << golden_filename << std::endl;
+            return true;
+        }
+        
+        SDL_Surface* loaded = IMG_Load( golden_filename.c_str() );
+        if( loaded == nullptr )
+        {
+            std::cerr
+                << test.name
+                << ": could not load golden image \""
+                << golden_filename
+                << "\": "
+                << IMG_GetError()
+                << " (run with GL_TUT_UPDATE_GOLDEN=1 to create it)"
+                << std::endl
+            ;
+            return false;
+        }
+        SDL_Surface* golden = SDL_ConvertSurfaceFormat(
+            loaded,
+            SDL_PIXELFORMAT_RGB24,
+            0
+        );
+        SDL_FreeSurface( loaded );
+        if( golden == nullptr )
+            throw std::runtime_error(
+                "failed to convert golden image \""
+                + golden_filename
+                + "\": "
+                + std::string( SDL_GetError() )
+            );
+        
+        if( golden -> w != framebuffer.width || golden -> h != framebuffer.height )
+        {
+            std::cerr
+                << test.name
+                << ": golden image is "
+                << golden -> w << "x" << golden -> h
+                << ", framebuffer is "
+                << framebuffer.width << "x" << framebuffer.height
+                << std::endl
+            ;
+            SDL_FreeSurface( golden );
+            return false;
+        }
+        
+        long mismatched_pixels = 0;
+        int  first_x = 0;
+        int  first_y = 0;
+        for( int y = 0; y < golden -> h; ++y )
+        {
+            auto golden_row = static_cast< unsigned char* >( golden -> pixels )
+                + y * golden -> pitch;
+            auto actual_row = pixels.data() + y * framebuffer.width * 3;
+            for( int x = 0; x < golden -> w; ++x )
+            {
+                bool pixel_matches = true;
+                for( int c = 0; c < 3; ++c )
+                    if(
+                        std::abs(
+                            golden_row[ x * 3 + c ] - actual_row[ x * 3 + c ]
+                        ) > golden_channel_tolerance
+                    )
+                        pixel_matches = false;
+                if( !pixel_matches && mismatched_pixels++ == 0 )
+                {
+                    first_x = x;
+                    first_y = y;
+                }
+            }
+        }
+        SDL_FreeSurface( golden );
+        
+        if( mismatched_pixels == 0 )
+            return true;
+        
+        // Written to the working directory (the build directory under ctest)
+        std::string actual_filename = test.name + "_actual.png";
+        save_png(
+            actual_filename,
+            pixels,
+            framebuffer.width,
+            framebuffer.height
+        );
+        std::cerr
+            << test.name
+            << ": "
+            << mismatched_pixels
+            << " pixels differ from "
+            << golden_filename
+            << ", first at ("
+            << first_x << ", " << first_y
+            << "); actual frame saved to "
+            << actual_filename
+            << std::endl
+        ;
+        return false;
+    }
+    
+    // Format: one "<step> <median ms> <CI lower ms> <CI upper ms>
+    // [<max slowdown>]" per line, '#' starts a comment
+    std::map< std::string, baseline > load_baselines()
+    {
+        std::map< std::string, baseline > baselines;
+        
+        std::ifstream file( baseline_file );
+        if( !file.is_open() )
+            return baselines;
+        
+        std::string line;
+        while( std::getline( file, line ) )
+        {
+            line = line.substr( 0, line.find( '#' ) );
+            std::istringstream fields( line );
+            std::string name;
+            baseline value;
+            if( !( fields >> name ) )
+                continue;
+            if( !(
+                fields
+                    >> value.recorded.median_ms
+                    >> value.recorded.lower_ms
+                    >> value.recorded.upper_ms
+            ) )
+                throw std::runtime_error(
+                    "malformed line in \"" + baseline_file + "\": " + line
+                );
+            if( !( fields >> value.max_slowdown ) )
+                value.max_slowdown = default_max_slowdown;
+            baselines[ name ] = value;
+        }
+        
+        return baselines;
+    }
+    
+    void save_baselines(
+        const std::map< std::string, baseline >& baselines,
+        const std::string& renderer
+    )
+    {
+        std::ofstream file( baseline_file );
+        if( !file.is_open() )
+            throw std::runtime_error(
+                "could not open \"" + baseline_file + "\" for writing"
+            );
+        file
+            << "# Per-run step times recorded on \"" << renderer << "\" from\n"
+            << "# the CMAKE_BUILD_TYPE Debug build CMakeLists.txt forces, so\n"
+            << "# compare only against that configuration.  Regenerate with\n"
+            << "# GL_TUT_UPDATE_BASELINES=1 ctest\n"
+            << "# <step> <median ms> <CI lower ms> <CI upper ms> <max slowdown>\n"
+        ;
+        for( auto& entry : baselines )
+            file
+                << entry.first
+                << " "
+                << entry.second.recorded.median_ms
+                << " "
+                << entry.second.recorded.lower_ms
+                << " "
+                << entry.second.recorded.upper_ms
+                << " "
+                << entry.second.max_slowdown
+                << "\n"
+            ;
+    }
+    
+    timing sample_timing(
+        gl_tut::render_step& step,
+        gl_tut::GL_framebuffer& framebuffer
+    )
+    {
+        for( int i = 0; i < timing_warmup_runs; ++i )
+            run_step( step, framebuffer );
+        
+        std::vector< double > samples;
+        for( int i = 0; i < timing_samples; ++i )
+        {
+            glBindFramebuffer( GL_FRAMEBUFFER, framebuffer.id );
+            glFinish();
+            auto start_time = std::chrono::steady_clock::now();
+            for( int j = 0; j < timing_runs_per_sample; ++j )
+                step.run( framebuffer );
+            glFinish();
+            std::chrono::duration< double, std::milli > elapsed = (
+                std::chrono::steady_clock::now() - start_time
+            );
+            samples.push_back( elapsed.count() / timing_runs_per_sample );
+        }
+        std::sort( samples.begin(), samples.end() );
+        
+        std::size_t n = samples.size();
+        timing result;
+        result.median_ms = (
+            n % 2 ? samples[ n / 2 ]
+                  : ( samples[ n / 2 - 1 ] + samples[ n / 2 ] ) / 2.0
+        );
+        
+        // Distribution-free ~95% confidence interval for the median from
+        // order statistics, which stays robust against scheduler outliers
+        double half_width = 1.96 * std::sqrt( static_cast< double >( n ) ) / 2.0;
+        std::size_t lower_rank = static_cast< std::size_t >( std::max(
+            0.0,
+            std::floor( n / 2.0 - half_width ) - 1.0
+        ) );
+        std::size_t upper_rank = static_cast< std::size_t >( std::min(
+            n - 1.0,
+            std::ceil( n / 2.0 + half_width ) - 1.0
+        ) );
+        result.lower_ms = samples[ lower_rank ];
+        result.upper_ms = samples[ upper_rank ];
+        
+        return result;
+    }
+    
+    check_result check_timing(
+        const test_case& test,
+        gl_tut::GL_framebuffer& framebuffer,
+        std::map< std::string, baseline >& baselines,
+        bool update
+    )
+    {
+        timing measured = sample_timing( *test.step, framebuffer );
+        
+        std::cout
+            << test.name
+            << ": median "
+            << measured.median_ms
+            << "ms, 95% CI ["
+            << measured.lower_ms
+            << ", "
+            << measured.upper_ms
+            << "]ms"
+        ;
+        
+        auto found = baselines.find( test.name );
+        if( update )
+        {
+            double max_slowdown = (
+                found == baselines.end() ? default_max_slowdown
+                                         : found -> second.max_slowdown
+            );
+            baselines[ test.name ] = { measured, max_slowdown };
+            std::cout << " (baseline updated)" << std::endl;
+            return check_result::passed;
+        }
+        if( found == baselines.end() )
+        {
+            std::cout
+                << " (no baseline, run with GL_TUT_UPDATE_BASELINES=1 to"
+                   " record one)"
+                << std::endl
+            ;
+            return check_result::skipped;
+        }
+        
+        const timing& recorded = found -> second.recorded;
+        double limit = recorded.upper_ms * ( 1.0 + found -> second.max_slowdown );
+        std::cout
+            << ", baseline CI ["
+            << recorded.lower_ms
+            << ", "
+            << recorded.upper_ms
+            << "]ms, limit "
+            << limit
+            << "ms"
+            << std::endl
+        ;
+        
+        // Only fail when this run's whole interval sits past the baseline's
+        // whole interval plus the allowed slowdown, so noise in either run
+        // does not trip it but a real slowdown does
+        if( measured.lower_ms > limit )
+        {
+            std::cerr
+                << test.name
+                << ": significant slowdown, median "
+                << measured.median_ms
+                << "ms vs baseline "
+                << recorded.median_ms
+                << "ms"
+                << std::endl
+            ;
+            return check_result::failed;
+        }
+        return check_result::passed;
+    }
+}
+
+
+int main( int argc, char* argv[] )
+{
+    try
+    {
+        gl_tut::SDL_manager sdl;
+        
+        gl_tut::SDL_window window(
+            "gl_tut_test",
+            SDL_WINDOWPOS_UNDEFINED,
+            SDL_WINDOWPOS_UNDEFINED,
+            framebuffer_width,
+            framebuffer_height,
+            SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+        );
+        
+        gl_tut::init_gl_extensions();
+        
+        const GLubyte* renderer_string = glGetString( GL_RENDERER );
+        std::string renderer = (
+            renderer_string == nullptr ? "" :
+            reinterpret_cast< const char* >( renderer_string )
+        );
+        std::cout << "GL renderer: " << renderer << std::endl;
+        bool expected_renderer_found = (
+            renderer.find( expected_renderer ) != std::string::npos
+        );
+        
+        bool update_golden    = env_set( "GL_TUT_UPDATE_GOLDEN"    );
+        bool update_baselines = env_set( "GL_TUT_UPDATE_BASELINES" );
+        if( ( update_golden || update_baselines ) && !expected_renderer_found )
+            throw std::runtime_error(
+                "refusing to record golden images or baselines on \""
+                + renderer
+                + "\", expected "
+                + expected_renderer
+            );
+        
+        gl_tut::GL_framebuffer framebuffer(
+            framebuffer_width,
+            framebuffer_height
+        );
+        
+        int failures = 0;
+        int skipped  = 0;
+        
+        // The CPU reference does not depend on the rasterizer, so this runs
+        // on any renderer
+        gl_tut::feedback_render_step feedback_step;
+        if( !check_feedback( feedback_step, framebuffer ) )
+            ++failures;
+        
+        // Steps that draw into the framebuffer, each compared against
+        // test/golden/<name>.png; none yet, as feedback_render_step only
+        // writes its transform feedback buffer under GL_RASTERIZER_DISCARD
+        std::vector< test_case > golden_tests;
+        
+        std::vector< test_case > timing_tests = {
+            { "feedback", &feedback_step }
+        };
+        
+        if( !expected_renderer_found )
+        {
+            std::cerr
+                << "renderer is not "
+                << expected_renderer
+                << ", skipping golden image and timing checks"
+                << std::endl
+            ;
+            ++skipped;
+        }
+        else
+        {
+            for( auto& test : golden_tests )
+                if( !check_golden( test, framebuffer, update_golden ) )
+                    ++failures;
+            
+            auto baselines = load_baselines();
+            for( auto& test : timing_tests )
+                switch( check_timing(
+                    test,
+                    framebuffer,
+                    baselines,
+                    update_baselines
+                ) )
+                {
+                case check_result::passed:
+                    break;
+                case check_result::failed:
+                    ++failures;
+                    break;
+                case check_result::skipped:
+                    ++skipped;
+                    break;
+                }
+            if( update_baselines )
+                save_baselines( baselines, renderer );
+        }
+        
+        if( failures )
+        {
+            std::cerr << failures << " check(s) failed" << std::endl;
+            return -1;
+        }
+        if( skipped )
+        {
+            std::cerr << skipped << " check(s) skipped" << std::endl;
+            return skip_return_code;
+        }
+        return 0;
+    }
+    catch( const std::exception& e )
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}